@@ -32,6 +32,7 @@ check_symbol_exists(strsignal "string.h" HAVE_STRSIGNAL)
 check_symbol_exists(updwtmpx "utmpx.h" HAVE_UPDWTMPX)
 check_symbol_exists(fstatat "sys/types.h;sys/stat.h;unistd.h" HAVE_FSTATAT)
 check_symbol_exists(dirfd "sys/types.h;dirent.h" HAVE_DIRFD)
+check_symbol_exists(epoll_create1 "sys/epoll.h" HAVE_EPOLL)
 check_symbol_exists(setpwent "sys/types.h;pwd.h" HAVE_SETPWENT)
 check_symbol_exists(endpwent "sys/types.h;pwd.h" HAVE_ENDPWENT)
 check_symbol_exists(getauxval "sys/auxv.h" HAVE_GETAUXVAL)
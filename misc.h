@@ -142,6 +142,10 @@ void bufchain_clear(bufchain *ch);
 size_t bufchain_size(bufchain *ch);
 void bufchain_add(bufchain *ch, const void *data, size_t len);
 ptrlen bufchain_prefix(bufchain *ch);
+/* Fill in up to maxout ptrlens describing the initial granules of the
+ * chain, returning how many were written. Consuming the total length
+ * of those ptrlens (or any prefix of it) invalidates them. */
+size_t bufchain_prefixes(bufchain *ch, ptrlen *out, size_t maxout);
 void bufchain_consume(bufchain *ch, size_t len);
 void bufchain_fetch(bufchain *ch, void *data, size_t len);
 void bufchain_fetch_consume(bufchain *ch, void *data, size_t len);
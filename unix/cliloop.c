@@ -2,6 +2,42 @@
 
 #include "putty.h"
 
+/*
+ * If the system supports epoll, we keep a single long-lived
+ * pollwrapper in epoll mode, and uxsel_input_add and
+ * uxsel_input_remove (below) keep its set of persistent fds up to
+ * date as uxsel fds come and go. Then each iteration of the main loop
+ * only has to deal with the fds that are actually ready.
+ *
+ * If epoll isn't available, we fall back to rebuilding a plain poll()
+ * set from the whole uxsel tree on every iteration.
+ */
+static pollwrapper *epoll_pw;
+static bool epoll_tried;
+
+static pollwrapper *cliloop_epoll_pw(void)
+{
+    if (!epoll_tried) {
+        epoll_tried = true;
+        epoll_pw = pollwrap_new_epoll();
+    }
+    return epoll_pw;
+}
+
+static void cliloop_dispatch(int fd, int rwx)
+{
+    /*
+     * We must process exceptional notifications before ordinary
+     * readability ones, or we may go straight past the urgent marker.
+     */
+    if (rwx & SELECT_X)
+        select_result(fd, SELECT_X);
+    if (rwx & SELECT_R)
+        select_result(fd, SELECT_R);
+    if (rwx & SELECT_W)
+        select_result(fd, SELECT_W);
+}
+
 void cli_main_loop(cliloop_pw_setup_t pw_setup,
                    cliloop_pw_check_t pw_check,
                    cliloop_continue_t cont, void *ctx)
@@ -11,7 +47,10 @@ void cli_main_loop(cliloop_pw_setup_t pw_setup,
     int *fdlist = NULL;
     size_t fdsize = 0;
 
-    pollwrapper *pw = pollwrap_new();
+    pollwrapper *pw = cliloop_epoll_pw();
+    bool using_epoll = (pw != NULL);
+    if (!using_epoll)
+        pw = pollwrap_new();
 
     while (true) {
         int rwx;
@@ -24,24 +63,26 @@ void cli_main_loop(cliloop_pw_setup_t pw_setup,
         if (!pw_setup(ctx, pw))
             break; /* our client signalled emergency exit */
 
-        /* Count the currently active fds. */
-        size_t nfds = 0;
-        for (int fd = first_fd(&fdstate, &rwx); fd >= 0;
-             fd = next_fd(&fdstate, &rwx))
-            nfds++;
+        size_t fdcount = 0;
+        if (!using_epoll) {
+            /* Count the currently active fds. */
+            size_t nfds = 0;
+            for (int fd = first_fd(&fdstate, &rwx); fd >= 0;
+                 fd = next_fd(&fdstate, &rwx))
+                nfds++;
 
-        /* Expand the fdlist buffer if necessary. */
-        sgrowarray(fdlist, fdsize, nfds);
+            /* Expand the fdlist buffer if necessary. */
+            sgrowarray(fdlist, fdsize, nfds);
 
-        /*
-         * Add all currently open uxsel fds to pw, and store them in
-         * fdlist as well.
-         */
-        size_t fdcount = 0;
-        for (int fd = first_fd(&fdstate, &rwx); fd >= 0;
-             fd = next_fd(&fdstate, &rwx)) {
-            fdlist[fdcount++] = fd;
-            pollwrap_add_fd_rwx(pw, fd, rwx);
+            /*
+             * Add all currently open uxsel fds to pw, and store them
+             * in fdlist as well.
+             */
+            for (int fd = first_fd(&fdstate, &rwx); fd >= 0;
+                 fd = next_fd(&fdstate, &rwx)) {
+                fdlist[fdcount++] = fd;
+                pollwrap_add_fd_rwx(pw, fd, rwx);
+            }
         }
 
         if (toplevel_callback_pending()) {
@@ -84,20 +125,16 @@ void cli_main_loop(cliloop_pw_setup_t pw_setup,
 
         bool found_fd = (ret > 0);
 
-        for (size_t i = 0; i < fdcount; i++) {
-            int fd = fdlist[i];
-            int rwx = pollwrap_get_fd_rwx(pw, fd);
-            /*
-             * We must process exceptional notifications before
-             * ordinary readability ones, or we may go straight
-             * past the urgent marker.
-             */
-            if (rwx & SELECT_X)
-                select_result(fd, SELECT_X);
-            if (rwx & SELECT_R)
-                select_result(fd, SELECT_R);
-            if (rwx & SELECT_W)
-                select_result(fd, SELECT_W);
+        if (using_epoll) {
+            size_t readystate = 0;
+            int fd;
+            while (pollwrap_epoll_next_ready(pw, &readystate, &fd, &rwx))
+                cliloop_dispatch(fd, rwx);
+        } else {
+            for (size_t i = 0; i < fdcount; i++) {
+                int fd = fdlist[i];
+                cliloop_dispatch(fd, pollwrap_get_fd_rwx(pw, fd));
+            }
         }
 
         pw_check(ctx, pw);
@@ -108,7 +145,8 @@ void cli_main_loop(cliloop_pw_setup_t pw_setup,
             break;
     }
 
-    pollwrap_free(pw);
+    if (!using_epoll)
+        pollwrap_free(pw);
     sfree(fdlist);
 }
 
@@ -117,9 +155,31 @@ void cliloop_no_pw_check(void *ctx, pollwrapper *pw) {}
 bool cliloop_always_continue(void *ctx, bool fd, bool cb) { return true; }
 
 /*
- * Any application using this main loop doesn't need to do anything
- * when uxsel adds or removes an fd, because we synchronously re-check
- * the current list every time we go round the main loop above.
+ * In poll() mode, we don't need to do anything when uxsel adds or
+ * removes an fd, because we synchronously re-check the current list
+ * every time we go round the main loop above. In epoll mode, we
+ * update the kernel's registration for the fd immediately.
  */
-uxsel_id *uxsel_input_add(int fd, int rwx) { return NULL; }
-void uxsel_input_remove(uxsel_id *id) { }
+struct uxsel_id {
+    int fd;
+};
+
+uxsel_id *uxsel_input_add(int fd, int rwx)
+{
+    pollwrapper *pw = cliloop_epoll_pw();
+    if (!pw)
+        return NULL;
+
+    pollwrap_epoll_set_fd_rwx(pw, fd, rwx);
+    uxsel_id *id = snew(uxsel_id);
+    id->fd = fd;
+    return id;
+}
+
+void uxsel_input_remove(uxsel_id *id)
+{
+    /* We only ever hand out ids in epoll mode */
+    assert(epoll_pw);
+    pollwrap_epoll_set_fd_rwx(epoll_pw, id->fd, 0);
+    sfree(id);
+}
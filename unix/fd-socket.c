@@ -8,6 +8,7 @@
 #include <errno.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <sys/uio.h>
 
 #include "tree234.h"
 #include "putty.h"
@@ -175,8 +176,10 @@ static int fdsocket_try_send(FdSocket *fds)
     while (bufchain_size(&fds->pending_output_data) > 0) {
         ssize_t ret;
 
-        ptrlen data = bufchain_prefix(&fds->pending_output_data);
-        ret = write(fds->outfd, data.ptr, data.len);
+        struct iovec iov[BUFCHAIN_MAX_IOV];
+        size_t niov = bufchain_iovecs(
+            &fds->pending_output_data, iov, lenof(iov));
+        ret = writev(fds->outfd, iov, niov);
         noise_ultralight(NOISE_SOURCE_IOID, ret);
         if (ret < 0 && errno != EWOULDBLOCK) {
             if (!fds->pending_error) {
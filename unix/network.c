@@ -11,6 +11,7 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/ioctl.h>
+#include <sys/uio.h>
 #include <arpa/inet.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
@@ -1105,23 +1106,26 @@ static void socket_error_callback(void *vs)
 void try_send(NetSocket *s)
 {
     while (s->sending_oob || bufchain_size(&s->output_data) > 0) {
-        int nsent;
+        ssize_t nsent;
         int err;
-        const void *data;
-        size_t len;
-        int urgentflag;
+        size_t len = 0;
 
         if (s->sending_oob) {
-            urgentflag = MSG_OOB;
             len = s->sending_oob;
-            data = &s->oobdata;
+            nsent = send(s->s, &s->oobdata, len, MSG_NOSIGNAL | MSG_OOB);
         } else {
-            urgentflag = 0;
-            ptrlen bufdata = bufchain_prefix(&s->output_data);
-            data = bufdata.ptr;
-            len = bufdata.len;
+            /*
+             * Send as much of the buffer chain as we can describe in
+             * one go, rather than one granule per system call.
+             */
+            struct iovec iov[BUFCHAIN_MAX_IOV];
+            struct msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = iov;
+            msg.msg_iovlen = bufchain_iovecs(
+                &s->output_data, iov, BUFCHAIN_MAX_IOV);
+            nsent = sendmsg(s->s, &msg, MSG_NOSIGNAL);
         }
-        nsent = send(s->s, data, len, MSG_NOSIGNAL | urgentflag);
         noise_ultralight(NOISE_SOURCE_IOLEN, nsent);
         if (nsent <= 0) {
             err = (nsent < 0 ? errno : 0);
@@ -354,6 +354,12 @@ void cloexec(int);
 void noncloexec(int);
 bool nonblock(int);
 bool no_nonblock(int);
+/* Fill in up to maxiov iovecs from the start of a bufchain. A limit of
+ * BUFCHAIN_MAX_IOV is applied in any case, which is comfortably below
+ * IOV_MAX on every system we know of. */
+struct iovec;
+#define BUFCHAIN_MAX_IOV 64
+size_t bufchain_iovecs(bufchain *ch, struct iovec *iov, size_t maxiov);
 char *make_dir_and_check_ours(const char *dirname);
 char *make_dir_path(const char *path, mode_t mode);
 
@@ -468,6 +474,11 @@ static inline bool pollwrap_check_fd_rwx(pollwrapper *pw, int fd, int rwx)
 {
     return (pollwrap_get_fd_rwx(pw, fd) & rwx) != 0;
 }
+/* epoll mode: pollwrap_new_epoll returns NULL if it's not available */
+pollwrapper *pollwrap_new_epoll(void);
+void pollwrap_epoll_set_fd_rwx(pollwrapper *pw, int fd, int rwx);
+bool pollwrap_epoll_next_ready(pollwrapper *pw, size_t *state,
+                               int *fd, int *rwx);
 
 /*
  * cliloop.c.
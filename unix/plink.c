@@ -14,6 +14,7 @@
 #include <pwd.h>
 #include <sys/ioctl.h>
 #include <sys/time.h>
+#include <sys/uio.h>
 
 #include "putty.h"
 #include "ssh.h"
@@ -335,13 +336,17 @@ void try_output(bool is_stderr)
 
     if (bufchain_size(chain) > 0) {
         bool prev_nonblock = nonblock(fd);
-        ptrlen senddata;
+        size_t sendlen;
         do {
-            senddata = bufchain_prefix(chain);
-            ret = write(fd, senddata.ptr, senddata.len);
+            struct iovec iov[BUFCHAIN_MAX_IOV];
+            size_t niov = bufchain_iovecs(chain, iov, lenof(iov));
+            sendlen = 0;
+            for (size_t i = 0; i < niov; i++)
+                sendlen += iov[i].iov_len;
+            ret = writev(fd, iov, niov);
             if (ret > 0)
                 bufchain_consume(chain, ret);
-        } while (ret == senddata.len && bufchain_size(chain) != 0);
+        } while (ret == sendlen && bufchain_size(chain) != 0);
         if (!prev_nonblock)
             no_nonblock(fd);
         if (ret < 0 && errno != EAGAIN) {
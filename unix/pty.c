@@ -22,6 +22,7 @@
 #include <sys/stat.h>
 #include <sys/wait.h>
 #include <sys/ioctl.h>
+#include <sys/uio.h>
 #include <errno.h>
 #include <termios.h>
 
@@ -1249,8 +1250,9 @@ static void pty_try_write(Pty *pty)
     assert(pty->master_i >= 0);
 
     while (bufchain_size(&pty->output_data) > 0) {
-        ptrlen data = bufchain_prefix(&pty->output_data);
-        ret = write(pty->master_i, data.ptr, data.len);
+        struct iovec iov[BUFCHAIN_MAX_IOV];
+        size_t niov = bufchain_iovecs(&pty->output_data, iov, lenof(iov));
+        ret = writev(pty->master_i, iov, niov);
 
         if (ret < 0 && (errno == EWOULDBLOCK)) {
             /*
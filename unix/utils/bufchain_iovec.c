@@ -0,0 +1,21 @@
+/*
+ * Describe the initial granules of a bufchain as an array of struct
+ * iovec, so that a whole backlog of output data can be passed to a
+ * single writev() or sendmsg() call without first being copied into
+ * a contiguous buffer.
+ */
+
+#include <sys/uio.h>
+
+#include "putty.h"
+
+size_t bufchain_iovecs(bufchain *ch, struct iovec *iov, size_t maxiov)
+{
+    ptrlen pls[BUFCHAIN_MAX_IOV];
+    size_t n = bufchain_prefixes(ch, pls, min(maxiov, lenof(pls)));
+    for (size_t i = 0; i < n; i++) {
+        iov[i].iov_base = (void *)pls[i].ptr;
+        iov[i].iov_len = pls[i].len;
+    }
+    return n;
+}
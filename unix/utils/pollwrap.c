@@ -17,22 +17,69 @@
  * classification and the richer poll flags. We have to stick to r/w/x
  * in this code base, because it ports to other systems where that's
  * all you get.
+ *
+ * On systems that have epoll, a pollwrapper can also be created in
+ * 'epoll mode' by pollwrap_new_epoll(). In that mode, as well as the
+ * transient fds added after each pollwrap_clear, it maintains a set
+ * of _persistent_ fds which are registered with the kernel once, via
+ * pollwrap_epoll_set_fd_rwx, and survive pollwrap_clear. After a
+ * poll, the persistent fds that are actually ready can be retrieved
+ * via pollwrap_epoll_next_ready, so that a main loop with thousands
+ * of idle fds doesn't have to rebuild or scan its whole fd set on
+ * every wakeup.
  */
 
 /* On some systems this is needed to get poll.h to define eg.. POLLRDNORM */
 #define _XOPEN_SOURCE
 
+#include <errno.h>
 #include <poll.h>
+#include <unistd.h>
 
 #include "putty.h"
 #include "tree234.h"
 
+#if HAVE_EPOLL
+#include <sys/epoll.h>
+#endif
+
+typedef struct pollwrap_persistent pollwrap_persistent;
+struct pollwrap_persistent {
+    int fd, rwx;
+};
+
 struct pollwrapper {
     struct pollfd *fds;
     size_t nfd, fdsize;
     tree234 *fdtopos;
+
+    /*
+     * Fields used only in epoll mode. 'epfd' is -1 in an ordinary
+     * pollwrapper.
+     *
+     * 'unpollable' lists persistent fds that epoll refused to accept
+     * (typically because they're regular files, which epoll doesn't
+     * support at all). Those are passed to poll() alongside the
+     * transient fds on every call instead.
+     *
+     * 'ready' is the list of persistent fds found ready by the most
+     * recent poll.
+     */
+    int epfd;
+    pollwrap_persistent *unpollable;
+    size_t nunpollable, unpollablesize;
+    pollwrap_persistent *ready;
+    size_t nready, readysize;
+#if HAVE_EPOLL
+    struct epoll_event *events;
+#endif
 };
 
+/* Maximum number of epoll events we retrieve in one wakeup. Since
+ * epoll is level-triggered by default, any further ready fds will
+ * simply be returned on the next call. */
+#define POLLWRAP_EPOLL_MAXEVENTS 256
+
 typedef struct pollwrap_fdtopos pollwrap_fdtopos;
 struct pollwrap_fdtopos {
     int fd;
@@ -53,7 +100,31 @@ pollwrapper *pollwrap_new(void)
     pw->nfd = 0;
     pw->fds = snewn(pw->fdsize, struct pollfd);
     pw->fdtopos = newtree234(pollwrap_fd_cmp);
+    pw->epfd = -1;
+    pw->unpollable = NULL;
+    pw->nunpollable = pw->unpollablesize = 0;
+    pw->ready = NULL;
+    pw->nready = pw->readysize = 0;
+#if HAVE_EPOLL
+    pw->events = NULL;
+#endif
+    return pw;
+}
+
+pollwrapper *pollwrap_new_epoll(void)
+{
+#if HAVE_EPOLL
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (epfd < 0)
+        return NULL;
+
+    pollwrapper *pw = pollwrap_new();
+    pw->epfd = epfd;
+    pw->events = snewn(POLLWRAP_EPOLL_MAXEVENTS, struct epoll_event);
     return pw;
+#else
+    return NULL;
+#endif
 }
 
 void pollwrap_free(pollwrapper *pw)
@@ -61,6 +132,13 @@ void pollwrap_free(pollwrapper *pw)
     pollwrap_clear(pw);
     freetree234(pw->fdtopos);
     sfree(pw->fds);
+#if HAVE_EPOLL
+    if (pw->epfd >= 0)
+        close(pw->epfd);
+    sfree(pw->events);
+#endif
+    sfree(pw->unpollable);
+    sfree(pw->ready);
     sfree(pw);
 }
 
@@ -131,20 +209,210 @@ void pollwrap_add_fd_rwx(pollwrapper *pw, int fd, int rwx)
     pollwrap_add_fd_events(pw, fd, events);
 }
 
+#if HAVE_EPOLL
+
+static int pollwrap_rwx_to_epoll(int rwx)
+{
+    int events = 0;
+    if (rwx & SELECT_R)
+        events |= EPOLLIN;
+    if (rwx & SELECT_W)
+        events |= EPOLLOUT;
+    if (rwx & SELECT_X)
+        events |= EPOLLPRI;
+    return events;
+}
+
+static int pollwrap_epoll_to_rwx(int events, int wanted)
+{
+    int rwx = 0;
+    if ((wanted & SELECT_R) && (events & (EPOLLIN | EPOLLERR | EPOLLHUP)))
+        rwx |= SELECT_R;
+    if ((wanted & SELECT_W) && (events & (EPOLLOUT | EPOLLERR)))
+        rwx |= SELECT_W;
+    if ((wanted & SELECT_X) && (events & EPOLLPRI))
+        rwx |= SELECT_X;
+    return rwx;
+}
+
+static int pollwrap_revents_to_rwx(int revents, int wanted)
+{
+    int rwx = 0;
+    if ((wanted & SELECT_R) && (revents & SELECT_R_OUT))
+        rwx |= SELECT_R;
+    if ((wanted & SELECT_W) && (revents & SELECT_W_OUT))
+        rwx |= SELECT_W;
+    if ((wanted & SELECT_X) && (revents & SELECT_X_OUT))
+        rwx |= SELECT_X;
+    return rwx;
+}
+
+static void pollwrap_add_ready(pollwrapper *pw, int fd, int rwx)
+{
+    sgrowarray(pw->ready, pw->readysize, pw->nready);
+    pw->ready[pw->nready].fd = fd;
+    pw->ready[pw->nready].rwx = rwx;
+    pw->nready++;
+}
+
+static int pollwrap_epoll_collect(pollwrapper *pw, int timeout)
+{
+    int n = epoll_wait(pw->epfd, pw->events, POLLWRAP_EPOLL_MAXEVENTS,
+                       timeout);
+    for (int i = 0; i < n; i++) {
+        /* We store the fd in the low half of the user data, and the
+         * rwx it was registered for in the high half, so we don't
+         * need to look anything up to interpret the event. */
+        uint64_t data = pw->events[i].data.u64;
+        int fd = (int)(data & 0xFFFFFFFFU);
+        int rwx = pollwrap_epoll_to_rwx(pw->events[i].events,
+                                        (int)(data >> 32));
+        if (rwx)
+            pollwrap_add_ready(pw, fd, rwx);
+    }
+    return n;
+}
+
+static int pollwrap_poll_epoll(pollwrapper *pw, int timeout)
+{
+    pw->nready = 0;
+
+    if (pw->nfd == 0 && pw->nunpollable == 0) {
+        /*
+         * Nothing to wait for except the persistent fds, so we can
+         * go straight to epoll_wait.
+         */
+        return pollwrap_epoll_collect(pw, timeout);
+    }
+
+    /*
+     * Otherwise, put the epoll fd itself into the poll array, after
+     * the transient fds and followed by any unpollable persistent
+     * ones. None of these extra entries is indexed in fdtopos, so
+     * they're invisible to pollwrap_get_fd_rwx.
+     */
+    size_t nextra = 1 + pw->nunpollable;
+    sgrowarray(pw->fds, pw->fdsize, pw->nfd + nextra);
+    struct pollfd *extra = pw->fds + pw->nfd;
+    extra[0].fd = pw->epfd;
+    extra[0].events = POLLIN;
+    extra[0].revents = 0;
+    for (size_t i = 0; i < pw->nunpollable; i++) {
+        int rwx = pw->unpollable[i].rwx, events = 0;
+        if (rwx & SELECT_R)
+            events |= SELECT_R_IN;
+        if (rwx & SELECT_W)
+            events |= SELECT_W_IN;
+        if (rwx & SELECT_X)
+            events |= SELECT_X_IN;
+        extra[1+i].fd = pw->unpollable[i].fd;
+        extra[1+i].events = events;
+        extra[1+i].revents = 0;
+    }
+
+    int ret = poll(pw->fds, pw->nfd + nextra, timeout);
+    if (ret <= 0)
+        return ret;
+
+    if (extra[0].revents & POLLIN)
+        pollwrap_epoll_collect(pw, 0);
+    for (size_t i = 0; i < pw->nunpollable; i++) {
+        int rwx = pollwrap_revents_to_rwx(extra[1+i].revents,
+                                          pw->unpollable[i].rwx);
+        if (rwx)
+            pollwrap_add_ready(pw, pw->unpollable[i].fd, rwx);
+    }
+    return ret;
+}
+
+#endif /* HAVE_EPOLL */
+
+static int pollwrap_poll(pollwrapper *pw, int timeout)
+{
+#if HAVE_EPOLL
+    if (pw->epfd >= 0)
+        return pollwrap_poll_epoll(pw, timeout);
+#endif
+    return poll(pw->fds, pw->nfd, timeout);
+}
+
 int pollwrap_poll_instant(pollwrapper *pw)
 {
-    return poll(pw->fds, pw->nfd, 0);
+    return pollwrap_poll(pw, 0);
 }
 
 int pollwrap_poll_endless(pollwrapper *pw)
 {
-    return poll(pw->fds, pw->nfd, -1);
+    return pollwrap_poll(pw, -1);
 }
 
 int pollwrap_poll_timeout(pollwrapper *pw, int milliseconds)
 {
     assert(milliseconds >= 0);
-    return poll(pw->fds, pw->nfd, milliseconds);
+    return pollwrap_poll(pw, milliseconds);
+}
+
+void pollwrap_epoll_set_fd_rwx(pollwrapper *pw, int fd, int rwx)
+{
+    assert(fd >= 0);
+    assert(pw->epfd >= 0);
+
+#if HAVE_EPOLL
+    /*
+     * If this fd is one epoll wouldn't take, just update or remove
+     * its entry in the unpollable list.
+     */
+    for (size_t i = 0; i < pw->nunpollable; i++) {
+        if (pw->unpollable[i].fd == fd) {
+            if (rwx) {
+                pw->unpollable[i].rwx = rwx;
+            } else {
+                pw->unpollable[i] = pw->unpollable[--pw->nunpollable];
+            }
+            return;
+        }
+    }
+
+    if (!rwx) {
+        /*
+         * Removal. ENOENT or EBADF here just mean the fd was already
+         * closed (which automatically unregisters it) or never made
+         * it into the set, so we ignore errors.
+         */
+        epoll_ctl(pw->epfd, EPOLL_CTL_DEL, fd, NULL);
+        return;
+    }
+
+    struct epoll_event ev;
+    ev.events = pollwrap_rwx_to_epoll(rwx);
+    ev.data.u64 = (uint64_t)(unsigned)fd | ((uint64_t)(unsigned)rwx << 32);
+
+    if (epoll_ctl(pw->epfd, EPOLL_CTL_ADD, fd, &ev) == 0)
+        return;
+    if (errno == EEXIST && epoll_ctl(pw->epfd, EPOLL_CTL_MOD, fd, &ev) == 0)
+        return;
+
+    /*
+     * epoll won't watch this fd (EPERM for a regular file, or
+     * ENOSPC if we've run into max_user_watches), so fall back to
+     * including it in every poll() call.
+     */
+    sgrowarray(pw->unpollable, pw->unpollablesize, pw->nunpollable);
+    pw->unpollable[pw->nunpollable].fd = fd;
+    pw->unpollable[pw->nunpollable].rwx = rwx;
+    pw->nunpollable++;
+#endif
+}
+
+bool pollwrap_epoll_next_ready(pollwrapper *pw, size_t *state,
+                               int *fd, int *rwx)
+{
+    if (*state >= pw->nready)
+        return false;
+    *fd = pw->ready[*state].fd;
+    *rwx = pw->ready[*state].rwx;
+    (*state)++;
+    return true;
 }
 
 static void pollwrap_get_fd_events_revents(pollwrapper *pw, int fd,
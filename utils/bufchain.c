@@ -7,6 +7,8 @@
  *  - return a (pointer,length) pair giving some initial data in
  *    the list, suitable for passing to a send or write system
  *    call
+ *  - return an array of such pairs covering several initial
+ *    granules, suitable for a scatter-gather write
  *  - retrieve a larger amount of initial data from the list
  *  - return the current size of the buffer chain in bytes
  */
@@ -125,6 +127,14 @@ ptrlen bufchain_prefix(bufchain *ch)
     return make_ptrlen(ch->head->bufpos, ch->head->bufend - ch->head->bufpos);
 }
 
+size_t bufchain_prefixes(bufchain *ch, ptrlen *out, size_t maxout)
+{
+    size_t n = 0;
+    for (struct bufchain_granule *b = ch->head; b && n < maxout; b = b->next)
+        out[n++] = make_ptrlen(b->bufpos, b->bufend - b->bufpos);
+    return n;
+}
+
 void bufchain_fetch(bufchain *ch, void *data, size_t len)
 {
     struct bufchain_granule *tmp;